@@ -1,176 +1,1038 @@
 #include <iostream>
 #include <cstdlib>
 #include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdint>
+#include <cctype>
+#include <chrono>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
 using namespace std;
 
 
-void Welcome_message();
-void exit_program();   
-void create_account();
-void deposit();
-void withdraw();
-void check_balance();
-void services_options();
+// Money is kept as a whole number of cents (minor units), so balances are
+// added and compared exactly, never through strings or floating point.
+typedef long long Money;
+const Money MAX_AMOUNT = 100000000000000LL; // 1,000,000,000,000.00 - keeps every sum far from overflow
+const Money MAX_BALANCE = 4000000000000000000LL;
 
+// "1500", "1500.5" or "1500.50" -> 150050 cents. No sign, at most two decimals.
+bool parse_amount(string_view text, Money &cents){
+	Money whole = 0, fraction = 0;
+	size_t i = 0, digits = 0, decimals = 0;
+	for (; i < text.size() && isdigit((unsigned char)text[i]); i++, digits++){
+		whole = whole * 10 + (text[i] - '0');
+		if (whole > MAX_AMOUNT / 100) return false;
+	}
+	if (i < text.size() && text[i] == '.'){
+		for (i++; i < text.size() && isdigit((unsigned char)text[i]) && decimals < 2; i++, decimals++){
+			fraction = fraction * 10 + (text[i] - '0');
+		}
+	}
+	if (i != text.size() || digits == 0) return false;
+	if (decimals == 1) fraction *= 10;
+	cents = whole * 100 + fraction;
+	return cents <= MAX_AMOUNT;
+}
+
+string format_amount(Money cents){
+	string sign = cents < 0 ? "-" : "";
+	unsigned long long value = cents < 0 ? 0ULL - (unsigned long long)cents : (unsigned long long)cents;
+	string fraction = to_string(value % 100);
+	return sign + to_string(value / 100) + "." + (fraction.size() < 2 ? "0" : "") + fraction;
+}
 
-void Welcome_message(){
-	cout << "Hello Welcome to Akiba Microfinance Bank E-services" << endl;
-	
+// Account numbers are printed as J + 9 digits; "J000000042" or "42" -> 42
+bool parse_accno(string_view text, long long &accno){
+	size_t i = (!text.empty() && (text[0] == 'J' || text[0] == 'j')) ? 1 : 0;
+	if (i == text.size() || text.size() - i > 9) return false;
+	accno = 0;
+	for (; i < text.size(); i++){
+		if (!isdigit((unsigned char)text[i])) return false;
+		accno = accno * 10 + (text[i] - '0');
+	}
+	return accno > 0;
 }
 
-void exit_program(){
-	system("cls");
+string format_accno(long long accno){
+	string digits = to_string(accno);
+	return "J" + string(digits.size() < 9 ? 9 - digits.size() : 0, '0') + digits;
 }
 
 class Client{
 	public:
-		std::string balance = "1000000";
-		std::string accno = "J123456789";
+		long long accno = 0;
+		Money balance = 0;       // cents
+		Money overdraft = 0;     // how far below zero the balance may go, in cents
+		std::string name;
 		
 };
 
-	
-	
-	void create_account(){
-	string fname, lname, address, verify;
-	int age;
-	std::string nin, phonenumber;
-	cout << "Enter the following details to create your account" << endl;
-	cout << "What is your first name: " << endl;
-	cin >> fname;
-	cout << "What is your last name: " << endl;
-	cin >> lname;
-	cout << "What is your age: " << endl;
-	cin >> age;
-	cout << "Enter your Nida Number: " << endl;
-	cin >> nin;
-	cout << "What is your physical address: " << endl;
-	cin >> address;
-	cout << "Enter your phone number: " << endl;
-	cin >> phonenumber;
-	
-	cout << "Here is your information entered, crosscheck for any error" << endl;
-	cout << "Your name is: " << fname << " " << lname << endl;
-	cout << "Your age is: " << age << endl;
-	cout << "Nida number: " << nin << endl;
-	cout << "Your Physical address is: " << address << endl;
-	cout << "Phone Number: " << phonenumber << endl;
-	cout << "Press 'y' to verify this information and create account or press 'n' to decline: " << endl;
-	cin >> verify;
-	
-	if (verify == "y"){
-		cout << "Congrats you have sucessfully created your account" << endl;
-		cout << "We have sent you the details of your account through SMS" << endl;
-	}else if (verify == "n") {
-		system("cls");
-		create_account();
-	} else {
-		system("cls");
-		services_options();
-	}
-	
-	
-}
-
-void deposit(){
-		int deposit_amount;
-		int response2;
-		cout << "Enter Amount you want to deposit: " << endl;
-		cin >> deposit_amount;
-		cout << "Congrats! You have succesfully deposited  " << deposit_amount << endl;
-		cout << "Press 1 to back to Main Menu or Press 0 to exit: " << endl;
-		cin >> response2;
-		if (response2 == 1){
-			system("cls");
-			services_options();
-		} else if (response2 == 0){
-			exit_program();
-		} else {
-			cout << "Invalid response";
+// Hash table from account number to the account's position in the ledger.
+// Open addressing with linear probing: two flat arrays, no node per account,
+// kept at most half full so a lookup touches one or two slots.
+class AccountIndex{
+	public:
+		// Position of accno, or -1 if there is no such account
+		long long find(long long accno) const {
+			if (keys.empty()) return -1;
+			size_t mask = keys.size() - 1;
+			for (size_t i = hash(accno) & mask; ; i = (i + 1) & mask){
+				if (keys[i] == EMPTY) return -1;
+				if (keys[i] == accno) return positions[i];
+			}
 		}
-		
+
+		// accno must not be in the table yet
+		void insert(long long accno, uint32_t position){
+			if ((count + 1) * 2 > keys.size()) grow();
+			place(accno, position);
+			count++;
+		}
+
+		size_t memory_bytes() const { return keys.capacity() * sizeof(long long) + positions.capacity() * sizeof(uint32_t); }
+
+	private:
+		static constexpr long long EMPTY = 0; // account numbers start at 1
+		vector<long long> keys;
+		vector<uint32_t> positions;
+		size_t count = 0;
+
+		static size_t hash(long long accno){
+			uint64_t x = (uint64_t)accno * 0x9E3779B97F4A7C15ULL;
+			return (size_t)(x ^ (x >> 29));
+		}
+
+		void place(long long accno, uint32_t position){
+			size_t mask = keys.size() - 1;
+			size_t i = hash(accno) & mask;
+			while (keys[i] != EMPTY) i = (i + 1) & mask;
+			keys[i] = accno;
+			positions[i] = position;
+		}
+
+		void grow(){
+			vector<long long> old_keys(max<size_t>(16, keys.size() * 2), EMPTY);
+			vector<uint32_t> old_positions(old_keys.size());
+			old_keys.swap(keys);
+			old_positions.swap(positions);
+			for (size_t i = 0; i < old_keys.size(); i++){
+				if (old_keys[i] != EMPTY) place(old_keys[i], old_positions[i]);
+			}
+		}
+};
+
+enum class TxStatus { Ok, NoAccount, BadAmount, InsufficientFunds };
+
+const char *status_text(TxStatus status){
+	switch (status){
+		case TxStatus::Ok: return "OK";
+		case TxStatus::NoAccount: return "No account with that number.";
+		case TxStatus::BadAmount: return "Invalid amount.";
+		case TxStatus::InsufficientFunds: return "Insufficient funds.";
 	}
+	return "";
+}
+
+// The rules behind deposit, withdraw and transfer, on bare balances, so the
+// replay engine below applies exactly the same ones
+TxStatus apply_deposit(Money &balance, Money amount){
+	if (amount <= 0 || amount > MAX_AMOUNT || balance > MAX_BALANCE - amount) return TxStatus::BadAmount;
+	balance += amount;
+	return TxStatus::Ok;
+}
+
+// Refused if it would take the balance below -overdraft
+TxStatus apply_withdraw(Money &balance, Money overdraft, Money amount){
+	if (amount <= 0 || amount > MAX_AMOUNT) return TxStatus::BadAmount;
+	if (balance - amount < -overdraft) return TxStatus::InsufficientFunds;
+	balance -= amount;
+	return TxStatus::Ok;
+}
+
+TxStatus apply_transfer(Money &from, Money from_overdraft, Money &to, Money amount){
+	if (amount <= 0 || amount > MAX_AMOUNT || to > MAX_BALANCE - amount) return TxStatus::BadAmount;
+	if (from - amount < -from_overdraft) return TxStatus::InsufficientFunds;
+	from -= amount;
+	to += amount;
+	return TxStatus::Ok;
+}
+
+// One line of a transaction file, with its account numbers already looked up
+// as positions in the ledger:
+//     D|<accno>|<amount>          deposit
+//     W|<accno>|<amount>          withdraw
+//     T|<from>|<to>|<amount>      transfer (to another account)
+const uint32_t NO_ACCOUNT = UINT32_MAX;
+
+struct Transaction{
+	Money amount = 0;
+	uint32_t account = NO_ACCOUNT;   // the payer for a transfer
+	uint32_t other = NO_ACCOUNT;     // the payee for a transfer
+	char kind = 0;                   // 'D', 'W' or 'T'; 0 for a blank or malformed line
+};
+
+struct ReplayReport{
+	long long outcomes[4] = {0, 0, 0, 0}; // transactions per TxStatus
+	long long malformed = 0;
+	double seconds = 0, apply_seconds = 0;
+
+	long long transactions() const { return outcomes[0] + outcomes[1] + outcomes[2] + outcomes[3]; }
+};
+
+// Run fn(0) .. fn(count - 1) on count threads (fn(0) on the caller's)
+template <class Fn>
+void run_threads(int count, Fn fn){
+	vector<thread> pool;
+	for (int t = 1; t < count; t++) pool.emplace_back(fn, t);
+	fn(0);
+	for (thread &th : pool) th.join();
+}
+
+// The bank's accounts, kept in memory and made durable with an append-only
+// journal plus periodic snapshots.
+// Every change is one journal line, numbered in sequence, written before the
+// call returns:
+//     <seq>|O|<accno>|<overdraft>|<name>     open account
+//     <seq>|D|<accno>|<cents>                deposit
+//     <seq>|W|<accno>|<cents>                withdraw
+// Once the journal holds more records than the bank has accounts (or
+// SNAPSHOT_EVERY, whichever is more) every account is written to the snapshot
+// file, whose first line is the last sequence number it includes:
+//     <seq>|<next accno>|<accounts>
+//     <accno>|<balance>|<overdraft>|<name>
+// The snapshot goes to a temp file renamed over the old one, then the journal
+// is started afresh. On startup the snapshot is loaded and the journal replayed,
+// skipping records the snapshot already includes, so a crash at any point
+// loses at most a half-written last line.
+class Ledger{
+	public:
+		Ledger(const string &snapshot_file_ = "bank.snapshot", const string &journal_file_ = "bank.journal")
+			: snapshot_file(snapshot_file_), journal_file(journal_file_){
+			load_snapshot();
+			// A torn last line must be gone before anything is appended after
+			// it, so fold the journal into a fresh snapshot, which empties it
+			if (replay_journal() && !save_snapshot()) cerr << "Warning: cannot write " << snapshot_file << "; " << journal_file << " ends in a torn record." << endl;
+			if (!journal.is_open()) journal.open(journal_file, ios::app);
+			if (!journal) cerr << "Warning: cannot open " << journal_file << " for writing." << endl;
+		}
+
+		~Ledger(){
+			if (journal_records > 0) save_snapshot();
+		}
+
+		Ledger(const Ledger &) = delete;
+		Ledger &operator=(const Ledger &) = delete;
+
+		// Open an account and return its number
+		long long open_account(const string &name, Money overdraft = 0){
+			long long accno = next_accno;
+			overdraft = min(max<Money>(overdraft, 0), MAX_AMOUNT);
+			string clean = name;
+			for (char &c : clean) if (c == '|' || c == '\n' || c == '\r') c = ' ';
+			apply_open(accno, overdraft, clean);
+			record("O|" + to_string(accno) + "|" + to_string(overdraft) + "|" + clean);
+			return accno;
+		}
+
+		TxStatus deposit(long long accno, Money amount){
+			long long i = index.find(accno);
+			if (i < 0) return TxStatus::NoAccount;
+			TxStatus status = apply_deposit(accounts[i].balance, amount);
+			if (status == TxStatus::Ok) record("D|" + to_string(accno) + "|" + to_string(amount));
+			return status;
+		}
+
+		TxStatus withdraw(long long accno, Money amount){
+			long long i = index.find(accno);
+			if (i < 0) return TxStatus::NoAccount;
+			TxStatus status = apply_withdraw(accounts[i].balance, accounts[i].overdraft, amount);
+			if (status == TxStatus::Ok) record("W|" + to_string(accno) + "|" + to_string(amount));
+			return status;
+		}
+
+		// The account, or nullptr. Valid until the next account is opened.
+		const Client *find(long long accno) const {
+			long long i = index.find(accno);
+			return i < 0 ? nullptr : &accounts[i];
+		}
+
+		size_t size() const { return accounts.size(); }
+
+		// Every balance, in ledger order (the order replay works on)
+		vector<Money> balances() const {
+			vector<Money> result(accounts.size());
+			for (size_t i = 0; i < accounts.size(); i++) result[i] = accounts[i].balance;
+			return result;
+		}
+
+		// Run a transaction file against balances (from balances()) with the
+		// given number of threads; 1 runs everything in file order on this
+		// thread. The accounts themselves are not touched; see commit_replay.
+		bool replay(const string &path, int threads, vector<Money> &balances, ReplayReport &report) const {
+			ifstream in(path, ios::binary);
+			if (!in) return false;
+			report = ReplayReport();
+			auto start = chrono::steady_clock::now();
+			string block, carry;
+			vector<Transaction> batch;
+			while (read_block(in, carry, block)){
+				parse_block(block, threads, batch, report);
+				auto applying = chrono::steady_clock::now();
+				if (threads <= 1){
+					for (const Transaction &t : batch) if (t.kind) report.outcomes[(int)apply(t, balances)]++;
+				} else {
+					apply_sharded(batch, threads, balances, report);
+				}
+				report.apply_seconds += chrono::duration<double>(chrono::steady_clock::now() - applying).count();
+			}
+			report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			return true;
+		}
+
+		// Make replayed balances the bank's, as one snapshot: a crash before
+		// it is written leaves the bank as it was before the replay
+		bool commit_replay(const vector<Money> &balances){
+			for (size_t i = 0; i < accounts.size() && i < balances.size(); i++) accounts[i].balance = balances[i];
+			seq++;
+			return save_snapshot();
+		}
+
+		size_t memory_bytes() const {
+			size_t total = accounts.capacity() * sizeof(Client) + index.memory_bytes();
+			for (const Client &c : accounts) total += c.name.capacity() > 15 ? c.name.capacity() + 1 : 0;
+			return total;
+		}
+
+		// Write every account to the snapshot file and start a new journal
+		bool save_snapshot(){
+			string tmp = snapshot_file + ".tmp";
+			{
+				ofstream out(tmp, ios::trunc);
+				if (!out) return false;
+				out << seq << '|' << next_accno << '|' << accounts.size() << '\n';
+				for (const Client &c : accounts){
+					out << c.accno << '|' << c.balance << '|' << c.overdraft << '|' << c.name << '\n';
+				}
+				out.flush();
+				if (!out) return false;
+			}
+			if (rename(tmp.c_str(), snapshot_file.c_str()) != 0){
+#ifdef _WIN32
+				remove(snapshot_file.c_str()); // rename does not replace on Windows
+				if (rename(tmp.c_str(), snapshot_file.c_str()) != 0) return false;
+#else
+				return false; // the old snapshot stays; the journal still covers it
+#endif
+			}
+			journal.close();
+			journal.open(journal_file, ios::trunc);
+			journal_records = 0;
+			return true;
+		}
+
+	private:
+		static constexpr long long SNAPSHOT_EVERY = 100000;
+
+		const string snapshot_file, journal_file;
+		vector<Client> accounts;
+		AccountIndex index;
+		long long next_accno = 1;
+		long long seq = 0;             // sequence number of the last change applied
+		ofstream journal;
+		long long journal_records = 0;
+
+		void apply_open(long long accno, Money overdraft, const string &name){
+			Client c;
+			c.accno = accno;
+			c.overdraft = overdraft;
+			c.name = name;
+			index.insert(accno, (uint32_t)accounts.size());
+			accounts.push_back(c);
+			if (accno >= next_accno) next_accno = accno + 1;
+		}
+
+		void record(const string &change){
+			seq++;
+			journal << seq << '|' << change << '\n';
+			journal.flush();
+			journal_records++;
+			if (journal_records >= max<long long>(SNAPSHOT_EVERY, (long long)accounts.size())) save_snapshot();
+		}
+
+		// Split "a|b|c" into at most n fields; the last one keeps any further '|'
+		static size_t split(const string &line, string *fields, size_t n){
+			size_t count = 0, start = 0;
+			while (count + 1 < n){
+				size_t bar = line.find('|', start);
+				if (bar == string::npos) break;
+				fields[count++] = line.substr(start, bar - start);
+				start = bar + 1;
+			}
+			fields[count++] = line.substr(start);
+			return count;
+		}
+
+		void load_snapshot(){
+			ifstream in(snapshot_file);
+			string line, f[4];
+			if (!getline(in, line) || split(line, f, 3) != 3) return;
+			seq = atoll(f[0].c_str());
+			next_accno = atoll(f[1].c_str());
+			size_t expected = (size_t)atoll(f[2].c_str());
+			accounts.reserve(expected);
+			while (getline(in, line)){
+				if (split(line, f, 4) != 4) continue;
+				long long accno = atoll(f[0].c_str());
+				if (accno <= 0 || index.find(accno) >= 0) continue;
+				apply_open(accno, atoll(f[2].c_str()), f[3]);
+				accounts.back().balance = atoll(f[1].c_str());
+			}
+		}
+
+		// A last line without a newline is a torn write from a crash and is
+		// skipped; returns true if there was one
+		bool replay_journal(){
+			ifstream in(journal_file);
+			string line, f[5];
+			while (getline(in, line)){
+				if (in.eof()) return true;
+				journal_records++;
+				size_t n = split(line, f, 5);
+				if (n < 4) continue;
+				long long record_seq = atoll(f[0].c_str());
+				if (record_seq <= seq) continue; // already in the snapshot
+				seq = record_seq;
+				long long accno = atoll(f[2].c_str());
+				long long value = atoll(f[3].c_str());
+				long long i = index.find(accno);
+				if (f[1] == "O" && n == 5 && i < 0) apply_open(accno, value, f[4]);
+				else if (f[1] == "D" && i >= 0) accounts[i].balance += value;
+				else if (f[1] == "W" && i >= 0) accounts[i].balance -= value;
+			}
+			return false;
+		}
+
+		// Replay. Files are read REPLAY_BLOCK bytes (whole lines) at a time;
+		// each block is parsed by all threads at once, one slice each, then
+		// applied.
+		// Applying is sharded: each thread owns a share of the accounts and runs
+		// every transaction that touches them, in file order, so
+		// each account sees exactly the sequence of changes it would see if the
+		// file were run start to finish on one thread. A transfer between two
+		// shards is in both owners' lists; each owner stops there, and the second
+		// to arrive runs it while the first waits, so it sees both balances
+		// exactly as sequential processing would. A thread only ever waits at a
+		// transfer for its other owner to get to that same transfer, and since
+		// both work through their lists in file order, the earliest such transfer
+		// always has both owners waiting at it; waits can't go round in a circle,
+		// so there is no deadlock.
+		static constexpr size_t REPLAY_BLOCK = size_t(64) << 20;
+
+		// Next block of whole lines; false at the end of the file
+		static bool read_block(istream &in, string &carry, string &block){
+			block.swap(carry);
+			carry.clear();
+			size_t have = block.size();
+			block.resize(have + REPLAY_BLOCK);
+			in.read(&block[have], REPLAY_BLOCK);
+			block.resize(have + (size_t)in.gcount());
+			if (block.empty()) return false;
+			size_t last = block.rfind('\n');
+			if (in && last != string::npos){
+				carry.assign(block, last + 1, string::npos);
+				block.resize(last + 1);
+			}
+			return true;
+		}
+
+		// Parse a block into batch (one Transaction per line), threads slices at once
+		void parse_block(const string &block, int threads, vector<Transaction> &batch, ReplayReport &report) const {
+			int slices = max(1, threads);
+			vector<size_t> cuts(slices + 1, block.size()), lines(slices + 1, 0);
+			cuts[0] = 0;
+			for (int k = 1; k < slices; k++){
+				size_t at = block.find('\n', max(cuts[k - 1], block.size() * k / slices));
+				cuts[k] = at == string::npos ? block.size() : at + 1;
+			}
+			run_threads(slices, [&](int k){
+				size_t n = (size_t)count(block.begin() + cuts[k], block.begin() + cuts[k + 1], '\n');
+				if (cuts[k + 1] > cuts[k] && block[cuts[k + 1] - 1] != '\n') n++;
+				lines[k + 1] = n;
+			});
+			for (int k = 0; k < slices; k++) lines[k + 1] += lines[k];
+			batch.assign(lines[slices], Transaction());
+			vector<long long> malformed(slices, 0);
+			run_threads(slices, [&](int k){
+				size_t pos = cuts[k], out = lines[k];
+				while (pos < cuts[k + 1]){
+					size_t end = block.find('\n', pos);
+					if (end == string::npos || end > cuts[k + 1]) end = cuts[k + 1];
+					string_view line(block.data() + pos, end - pos);
+					if (!parse_transaction(line, batch[out]) && !line.empty() && line != "\r") malformed[k]++;
+					out++;
+					pos = end + 1;
+				}
+			});
+			for (long long m : malformed) report.malformed += m;
+		}
+
+		bool parse_transaction(string_view line, Transaction &t) const {
+			if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+			string_view f[4];
+			size_t n = 0;
+			while (n < 4){
+				size_t bar = line.find('|');
+				f[n++] = line.substr(0, bar);
+				if (bar == string_view::npos) break;
+				line.remove_prefix(bar + 1);
+			}
+			if (f[0].size() != 1) return false;
+			char kind = f[0][0];
+			size_t fields = kind == 'T' ? 4 : 3;
+			long long accno = 0, other = 0;
+			if ((kind != 'D' && kind != 'W' && kind != 'T') || n != fields) return false;
+			if (!parse_accno(f[1], accno) || !parse_amount(f[fields - 1], t.amount)) return false;
+			if (kind == 'T' && (!parse_accno(f[2], other) || other == accno)) return false;
+			long long i = index.find(accno), j = kind == 'T' ? index.find(other) : -1;
+			t.account = i < 0 ? NO_ACCOUNT : (uint32_t)i;
+			t.other = j < 0 ? NO_ACCOUNT : (uint32_t)j;
+			t.kind = kind;
+			return true;
+		}
+
+		// Outcome of one transaction, applied to balances if it goes through
+		TxStatus apply(const Transaction &t, vector<Money> &balances) const {
+			if (t.account == NO_ACCOUNT) return TxStatus::NoAccount;
+			if (t.kind == 'D') return apply_deposit(balances[t.account], t.amount);
+			if (t.kind == 'W') return apply_withdraw(balances[t.account], accounts[t.account].overdraft, t.amount);
+			if (t.other == NO_ACCOUNT) return TxStatus::NoAccount;
+			return apply_transfer(balances[t.account], accounts[t.account].overdraft, balances[t.other], t.amount);
+		}
+
+		void apply_sharded(const vector<Transaction> &batch, int shards, vector<Money> &balances, ReplayReport &report) const {
+			// Accounts go to owners eight at a time, so no two threads write to
+			// the same cache line of balances
+			auto owner = [shards](uint32_t account){ return (int)((account / 8) % (uint32_t)shards); };
+			auto crosses = [&](const Transaction &t){
+				return t.kind == 'T' && t.other != NO_ACCOUNT && t.account != NO_ACCOUNT && owner(t.account) != owner(t.other);
+			};
+
+			// Each thread sorts its slice of the batch into one list per owner;
+			// owner w then works through lists[0][w], lists[1][w], ... in order
+			vector<vector<vector<uint32_t>>> lists(shards, vector<vector<uint32_t>>(shards));
+			run_threads(shards, [&](int k){
+				for (size_t i = batch.size() * k / shards; i < batch.size() * (k + 1) / shards; i++){
+					const Transaction &t = batch[i];
+					if (!t.kind) continue;
+					int a = owner(t.account == NO_ACCOUNT ? 0 : t.account);
+					lists[k][a].push_back((uint32_t)i);
+					if (crosses(t)) lists[k][owner(t.other)].push_back((uint32_t)i);
+				}
+			});
+
+			// arrived[i]: owners that have reached cross-shard transfer i; 3 once it has run
+			unique_ptr<atomic<uint8_t>[]> arrived(new atomic<uint8_t>[batch.size()]());
+			vector<ReplayReport> tallies(shards);
+			run_threads(shards, [&](int w){
+				long long outcomes[4] = {0, 0, 0, 0};
+				for (int k = 0; k < shards; k++){
+					for (uint32_t i : lists[k][w]){
+						const Transaction &t = batch[i];
+						if (crosses(t) && arrived[i].fetch_add(1, memory_order_acq_rel) == 0){
+							for (int spins = 0; arrived[i].load(memory_order_acquire) != 3; spins++){
+								if (spins > 100) this_thread::yield();
+							}
+							continue;
+						}
+						outcomes[(int)apply(t, balances)]++;
+						if (crosses(t)) arrived[i].store(3, memory_order_release);
+					}
+				}
+				copy(outcomes, outcomes + 4, tallies[w].outcomes);
+			});
+			for (const ReplayReport &r : tallies){
+				for (int s = 0; s < 4; s++) report.outcomes[s] += r.outcomes[s];
+			}
+		}
+};
+
+// The bank, loaded from bank.snapshot and bank.journal on first use
+Ledger &bank(){
+	static Ledger ledger;
+	return ledger;
+}
+
+// One customer's visit to the menu. The old screens called each other to get
+// back to the menu, so every visit deepened the stack; here each screen is a
+// state and input() moves between them, so a session of any length runs in
+// the same stack frame and the caller decides where the words come from.
+class Session{
+	public:
+		enum Screen { MENU, RETRY, DETAILS, VERIFY, ACCOUNT, AMOUNT, AGAIN, DONE };
 
+		Session(Ledger &ledger_, ostream &out_, bool clear_screens_)
+			: ledger(ledger_), out(out_), clear_screens(clear_screens_) {}
 
-void services_options(){
-	int service, retry;
-	cout << "Choose the services below" << endl;
-	cout << "1. Create account" << endl;
-	cout << "2. Deposit" << endl;
-	cout << "3. Withdraw" << endl;
-	cout << "4. Check Balance" << endl;
-	cin >> service;
-	if (service == 1){
-	create_account();
-	} else if (service == 2){
-	deposit();
-	}else if (service == 3){
-	withdraw();
-	} else if (service == 4){
-	check_balance();
-	} else {
-	cout << "Invalid Choice" << endl;
-	cout << "Retry enter the service you want!: " << endl;
-	cin >> retry;
-	services_options();
+		Screen screen() const { return state; }
+		bool done() const { return state == DONE; }
+
+		// Print the prompt for the current screen
+		void show(){
+			switch (state){
+				case MENU:
+					out << "Choose the services below" << '\n';
+					out << "1. Create account" << '\n';
+					out << "2. Deposit" << '\n';
+					out << "3. Withdraw" << '\n';
+					out << "4. Check Balance" << '\n';
+					break;
+				case RETRY:
+					out << "Retry enter the service you want!: " << '\n';
+					break;
+				case DETAILS:
+					if (field == 0) out << "Enter the following details to create your account" << '\n';
+					out << DETAIL_PROMPTS[field] << '\n';
+					break;
+				case VERIFY:
+					out << "Here is your information entered, crosscheck for any error" << '\n';
+					out << "Your name is: " << details[0] << " " << details[1] << '\n';
+					out << "Your age is: " << details[2] << '\n';
+					out << "Nida number: " << details[3] << '\n';
+					out << "Your Physical address is: " << details[4] << '\n';
+					out << "Phone Number: " << details[5] << '\n';
+					out << "Press 'y' to verify this information and create account or press 'n' to decline: " << '\n';
+					break;
+				case ACCOUNT:
+					out << "Enter your account number: " << '\n';
+					break;
+				case AMOUNT:
+					out << (service == 2 ? "Enter Amount you want to deposit: " : "Enter amount you want to withdraw: ") << '\n';
+					break;
+				case AGAIN:
+					out << "Press 1 to back to Main Menu or Press 0 to exit: " << '\n';
+					break;
+				case DONE:
+					break;
+			}
+			out.flush();
+		}
+
+		// Handle one word typed on the current screen
+		void input(const string &word){
+			switch (state){
+				case MENU:
+					if (word == "1"){
+						field = 0;
+						state = DETAILS;
+					} else if (word == "2" || word == "3" || word == "4"){
+						service = word[0] - '0';
+						state = ACCOUNT;
+					} else {
+						out << "Invalid Choice" << '\n';
+						state = RETRY;
+					}
+					break;
+				case RETRY:
+					state = MENU;
+					break;
+				case DETAILS:
+					if (field == 2 && !is_number(word)) break; // ask the age again
+					details[field++] = word;
+					if (field == 6) state = VERIFY;
+					break;
+				case VERIFY:
+					if (word == "y"){
+						long long opened = ledger.open_account(details[0] + " " + details[1]);
+						out << "Congrats you have sucessfully created your account" << '\n';
+						out << "Your account number is: " << format_accno(opened) << '\n';
+						out << "We have sent you the details of your account through SMS" << '\n';
+						state = DONE;
+					} else if (word == "n"){
+						clear_screen();
+						field = 0;
+						state = DETAILS;
+					} else {
+						clear_screen();
+						state = MENU;
+					}
+					break;
+				case ACCOUNT: {
+					const Client *client = parse_accno(word, accno) ? ledger.find(accno) : nullptr;
+					if (client == nullptr){
+						out << status_text(TxStatus::NoAccount) << '\n';
+						state = AGAIN;
+					} else if (service == 4){
+						out << "Account holder: " << client->name << '\n';
+						out << "Your Balance is:" << format_amount(client->balance) << '\n';
+						state = AGAIN;
+					} else {
+						state = AMOUNT;
+					}
+					break;
+				}
+				case AMOUNT: {
+					Money amount = 0;
+					TxStatus status = TxStatus::BadAmount;
+					if (parse_amount(word, amount)) status = service == 2 ? ledger.deposit(accno, amount) : ledger.withdraw(accno, amount);
+					if (status != TxStatus::Ok){
+						out << status_text(status) << '\n';
+					} else if (service == 2){
+						out << "Congrats! You have succesfully deposited  " << format_amount(amount) << '\n';
+					} else {
+						out << "Congrats! you have succesfully withdraw " << format_amount(amount) << " from your account" << '\n';
+					}
+					if (status == TxStatus::Ok) out << "Your new balance is: " << format_amount(ledger.find(accno)->balance) << '\n';
+					state = AGAIN;
+					break;
+				}
+				case AGAIN:
+					if (word == "1"){
+						clear_screen();
+						state = MENU;
+					} else if (word == "0"){
+						clear_screen();
+						state = DONE;
+					} else {
+						out << "Invalid response" << '\n';
+						state = DONE;
+					}
+					break;
+				case DONE:
+					break;
+			}
+		}
+
+	private:
+		static constexpr const char *DETAIL_PROMPTS[6] = {
+			"What is your first name: ", "What is your last name: ", "What is your age: ",
+			"Enter your Nida Number: ", "What is your physical address: ", "Enter your phone number: "
+		};
+
+		Ledger &ledger;
+		ostream &out;
+		bool clear_screens;
+		Screen state = MENU;
+		int service = 0;
+		int field = 0;
+		string details[6];
+		long long accno = 0;
+
+		static bool is_number(const string &word){
+			if (word.empty() || word.size() > 3) return false;
+			for (char c : word) if (!isdigit((unsigned char)c)) return false;
+			return true;
+		}
+
+		// ANSI clear and home instead of system("cls"), which started a shell
+		// for every screen; scripted runs leave it off so the output stays diffable.
+		void clear_screen(){
+			if (clear_screens) out << "\033[2J\033[H";
+		}
+};
+
+
+void Welcome_message(ostream &out){
+	out << "Hello Welcome to Akiba Microfinance Bank E-services" << '\n';
+}
+
+// Drive one session with words read from in until it ends; returns false if
+// the input ran out first.
+bool run_session(Session &session, istream &in, ostream &out){
+	Welcome_message(out);
+	string word;
+	while (!session.done()){
+		session.show();
+		if (!(in >> word)) return false;
+		session.input(word);
 	}
-	
+	return true;
 }
 
 
+// --script <file>: runs sessions back to back on the words in the file (or
+// standard input for "-") against the bank until the words run out.
+int run_script(const string &path){
+	ifstream file;
+	if (path != "-"){
+		file.open(path);
+		if (!file){
+			cerr << "Cannot open " << path << endl;
+			return 1;
+		}
+	}
+	istream &in = path == "-" ? cin : file;
+	long long sessions = 0;
+	auto start = chrono::steady_clock::now();
+	for (;;){
+		Session session(bank(), cout, false);
+		if (!run_session(session, in, cout)) break;
+		sessions++;
+	}
+	cout.flush();
+	double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cerr << sessions << " sessions completed in " << secs << " s" << endl;
+	return 0;
+}
 
 
+// Throws the screen output away but counts it, so --simulate measures the
+// menu and the ledger rather than the terminal.
+class CountingBuf : public streambuf{
+	public:
+		long long bytes = 0;
+	protected:
+		int overflow(int c) override {
+			if (c != EOF) bytes++;
+			return c == EOF ? 0 : c;
+		}
+		streamsize xsputn(const char *, streamsize n) override {
+			bytes += n;
+			return n;
+		}
+};
+
+// A customer who answers whatever screen is showing, mostly sensibly: about
+// one answer in twenty is a wrong choice, a mistyped age or a bad amount, so
+// every branch of the menu gets exercised.
+string customer_answer(const Session &session, const Ledger &ledger, mt19937_64 &rng){
+	bool mistake = rng() % 20 == 0;
+	switch (session.screen()){
+		case Session::MENU:
+			if (mistake) return "9";
+			return ledger.size() == 0 ? "1" : to_string(1 + rng() % 4);
+		case Session::RETRY:
+			return "1";
+		case Session::DETAILS:
+			return mistake ? "abc" : to_string(18 + rng() % 60);
+		case Session::VERIFY:
+			return mistake ? "n" : "y";
+		case Session::ACCOUNT:
+			if (mistake || ledger.size() == 0) return "J999999999";
+			return format_accno(1 + (long long)(rng() % ledger.size()));
+		case Session::AMOUNT:
+			return mistake ? "-5" : to_string(1 + rng() % 100000) + "." + to_string(rng() % 10) + "0";
+		case Session::AGAIN:
+			return mistake ? "x" : (rng() % 4 ? "1" : "0");
+		case Session::DONE:
+			break;
+	}
+	return "";
+}
 
-void withdraw(){
-	int withdraw_amount, response3;
-	cout << "Enter amount you want to withdraw: " << endl;
-	cin >> withdraw_amount;
-	cout << "Congrats! you have succesfully withdraw " << withdraw_amount << "from your account" << endl;
-	cout << "Press 1 to back to Main Menu or Press 0 to exit: " << endl;
-		cin >> response3;
-		if (response3 == 1){
-			system("cls");
-			services_options();
-		} else if (response3 == 0){
-			exit_program();
-		} else {
-			cout << "Invalid response";
+// --simulate <sessions> [seed]: runs that many customer sessions through the
+// menu against simulate.snapshot/simulate.journal and prints the rates.
+int run_simulate(long long session_count, unsigned long long seed){
+	remove("simulate.snapshot");
+	remove("simulate.journal");
+	Ledger ledger("simulate.snapshot", "simulate.journal");
+	CountingBuf sink;
+	ostream out(&sink);
+	mt19937_64 rng(seed);
+	long long inputs = 0, opened = 0, transactions = 0;
+	auto start = chrono::steady_clock::now();
+	for (long long i = 0; i < session_count; i++){
+		Session session(ledger, out, true);
+		Welcome_message(out);
+		while (!session.done()){
+			session.show();
+			Session::Screen before = session.screen();
+			size_t accounts = ledger.size();
+			session.input(customer_answer(session, ledger, rng));
+			inputs++;
+			if (ledger.size() != accounts) opened++;
+			if (before == Session::AMOUNT) transactions++;
 		}
+	}
+	double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "sessions: " << session_count << ", " << (long long)(session_count / secs) << " sessions/s" << endl;
+	cout << "inputs: " << inputs << ", " << (long long)(inputs / secs) << " inputs/s" << endl;
+	cout << "accounts opened: " << opened << ", amounts entered: " << transactions << endl;
+	cout << "screen output: " << sink.bytes << " bytes" << endl;
+	return 0;
 }
 
-void check_balance(){
-	std::string balance = "1000000";
-	int response4;
-	
-	cout << "Your Balance is:" << balance << endl;
-	cout << "Press 1 to back to Main Menu or Press 0 to exit: " << endl;
-		cin >> response4;
-		if (response4 == 1){
-			system("cls");
-			services_options();
-		} else if (response4 == 0){
-			exit_program();
-		} else {
-			cout << "Invalid response";
+
+// --bench [accounts] [transactions]: opens the accounts and runs random
+// deposits and withdrawals against them in bench.snapshot/bench.journal,
+// then prints the rates and the memory held per account.
+int run_bench(long long account_count, long long transaction_count){
+	remove("bench.snapshot");
+	remove("bench.journal");
+	mt19937_64 rng(42);
+	long long refused = 0;
+	double open_secs, tx_secs, snapshot_secs;
+	size_t memory;
+	{
+		Ledger ledger("bench.snapshot", "bench.journal");
+		auto t0 = chrono::steady_clock::now();
+		for (long long i = 0; i < account_count; i++) ledger.open_account("Customer " + to_string(i), (i % 10 == 0) ? 50000 : 0);
+		auto t1 = chrono::steady_clock::now();
+		for (long long i = 0; i < transaction_count; i++){
+			long long accno = 1 + (long long)(rng() % (uint64_t)account_count);
+			Money amount = 100 + (Money)(rng() % 1000000);
+			TxStatus status = (rng() % 2) ? ledger.deposit(accno, amount) : ledger.withdraw(accno, amount);
+			if (status != TxStatus::Ok) refused++;
 		}
-}	
+		auto t2 = chrono::steady_clock::now();
+		ledger.save_snapshot();
+		auto t3 = chrono::steady_clock::now();
+		open_secs = chrono::duration<double>(t1 - t0).count();
+		tx_secs = chrono::duration<double>(t2 - t1).count();
+		snapshot_secs = chrono::duration<double>(t3 - t2).count();
+		memory = ledger.memory_bytes();
+	}
+	auto t4 = chrono::steady_clock::now();
+	Ledger reloaded("bench.snapshot", "bench.journal");
+	double load_secs = chrono::duration<double>(chrono::steady_clock::now() - t4).count();
 
+	cout << "accounts: " << account_count << ", " << (long long)(account_count / open_secs) << " opened/s" << endl;
+	cout << "transactions: " << transaction_count << ", " << (long long)(transaction_count / tx_secs) << " tx/s, "
+		 << refused << " refused for insufficient funds" << endl;
+	cout << "snapshot: " << snapshot_secs << " s to write, " << load_secs << " s to load " << reloaded.size() << " accounts" << endl;
+	cout << "memory: " << memory / account_count << " bytes/account" << endl;
+	return 0;
+}
 
 
+// --generate <file> [accounts] [transactions] [ledger]: opens accounts in
+// <ledger>.snapshot/<ledger>.journal (default "replay", so the bank itself is
+// left alone) until it has that many, then writes random transactions against
+// them (45% deposits, 35% withdrawals, 20% transfers) for --replay.
+int run_generate(const string &path, long long account_count, long long transaction_count, const string &ledger_name){
+	Ledger ledger(ledger_name + ".snapshot", ledger_name + ".journal");
+	while ((long long)ledger.size() < account_count){
+		long long n = (long long)ledger.size() + 1;
+		ledger.open_account("Customer " + to_string(n), (n % 10 == 0) ? 50000 : 0);
+	}
+	ofstream out(path, ios::trunc);
+	if (!out){
+		cerr << "Error: cannot write " << path << "." << endl;
+		return 1;
+	}
+	mt19937_64 rng(7);
+	string line;
+	for (long long i = 0; i < transaction_count; i++){
+		unsigned kind = (unsigned)(rng() % 100);
+		long long accno = 1 + (long long)(rng() % (uint64_t)account_count);
+		string amount = format_amount(100 + (Money)(rng() % 500000));
+		if (kind < 45) line = "D|" + format_accno(accno) + "|" + amount;
+		else if (kind < 80) line = "W|" + format_accno(accno) + "|" + amount;
+		else {
+			long long other = 1 + (long long)(rng() % (uint64_t)account_count);
+			if (other == accno) other = other % account_count + 1; // never to itself
+			line = "T|" + format_accno(accno) + "|" + format_accno(other) + "|" + amount;
+		}
+		out << line << '\n';
+	}
+	out.close();
+	cout << "Wrote " << transaction_count << " transaction(s) over " << account_count << " account(s) in " << ledger_name << " to " << path << endl;
+	return out ? 0 : 1;
+}
 
+// --replay <file> [threads] [ledger]: runs the file once in order on one
+// thread, then sharded on 2, 4, ... up to threads (default: one per core),
+// checks each run ends with exactly the same balances, prints the throughput
+// of each, and commits the result to the ledger (default "replay", as for
+// --generate; pass "bank" to replay into the bank itself).
+int run_replay(const string &path, int max_threads, const string &ledger_name){
+	Ledger ledger(ledger_name + ".snapshot", ledger_name + ".journal");
+	const vector<Money> start = ledger.balances();
+	vector<Money> expected, balances;
+	ReplayReport report;
+	vector<int> counts{1};
+	for (int t = 2; t < max_threads; t *= 2) counts.push_back(t);
+	if (max_threads > 1) counts.push_back(max_threads);
 
+	bool all_same = true;
+	double sequential = 0;
+	cout << "threads   seconds      tx/s   apply s   speedup  balances" << endl;
+	for (int threads : counts){
+		balances = start;
+		if (!ledger.replay(path, threads, balances, report)){
+			cerr << "Error: cannot read " << path << "." << endl;
+			return 1;
+		}
+		bool same = threads == 1 || balances == expected;
+		if (threads == 1){
+			expected = balances;
+			sequential = report.seconds;
+		}
+		all_same = all_same && same;
+		printf("%7d %9.3f %9.0f %9.3f %8.2fx  %s\n", threads, report.seconds, report.transactions() / report.seconds,
+			report.apply_seconds, sequential / report.seconds, threads == 1 ? "(reference)" : same ? "same" : "DIFFERENT");
+	}
+	cout << report.transactions() << " transaction(s): " << report.outcomes[(int)TxStatus::Ok] << " ok, "
+		 << report.outcomes[(int)TxStatus::InsufficientFunds] << " insufficient funds, "
+		 << report.outcomes[(int)TxStatus::NoAccount] << " no such account, "
+		 << report.outcomes[(int)TxStatus::BadAmount] << " invalid amount; "
+		 << report.malformed << " malformed line(s) skipped" << endl;
+	if (!all_same){
+		cerr << "Error: sharded replay disagreed with sequential replay; nothing committed." << endl;
+		return 1;
+	}
+	if (!ledger.commit_replay(expected)){
+		cerr << "Error: cannot write " << ledger_name << ".snapshot." << endl;
+		return 1;
+	}
+	return 0;
+}
 
 
-int main(){
-	Welcome_message();
-	services_options();
-	
-	
-	
-	
-	
-	
-	
-	
+int main(int argc, char *argv[]){
+	if (argc >= 2 && string(argv[1]) == "--bench"){
+		long long accounts = argc >= 3 ? atoll(argv[2]) : 1000000;
+		long long transactions = argc >= 4 ? atoll(argv[3]) : 1000000;
+		if (accounts <= 0 || transactions < 0){
+			cerr << "Usage: " << argv[0] << " --bench [accounts] [transactions]" << endl;
+			return 1;
+		}
+		return run_bench(accounts, transactions);
+	}
+	if (argc >= 3 && string(argv[1]) == "--generate"){
+		long long accounts = argc >= 4 ? atoll(argv[3]) : 1000000;
+		long long transactions = argc >= 5 ? atoll(argv[4]) : 10000000;
+		if (accounts <= 0 || transactions < 0){
+			cerr << "Usage: " << argv[0] << " --generate <file> [accounts] [transactions] [ledger]" << endl;
+			return 1;
+		}
+		return run_generate(argv[2], accounts, transactions, argc >= 6 ? argv[5] : "replay");
+	}
+	if (argc >= 3 && string(argv[1]) == "--replay"){
+		int threads = argc >= 4 ? atoi(argv[3]) : (int)max(1u, thread::hardware_concurrency());
+		if (threads <= 0){
+			cerr << "Usage: " << argv[0] << " --replay <file> [threads] [ledger]" << endl;
+			return 1;
+		}
+		return run_replay(argv[2], threads, argc >= 5 ? argv[4] : "replay");
+	}
+	if (argc >= 3 && string(argv[1]) == "--script"){
+		return run_script(argv[2]);
+	}
+	if (argc >= 3 && string(argv[1]) == "--simulate"){
+		long long sessions = atoll(argv[2]);
+		unsigned long long seed = argc >= 4 ? strtoull(argv[3], nullptr, 10) : 42;
+		if (sessions <= 0){
+			cerr << "Usage: " << argv[0] << " --simulate <sessions> [seed]" << endl;
+			return 1;
+		}
+		return run_simulate(sessions, seed);
+	}
+	Session session(bank(), cout, isatty(fileno(stdout)) != 0);
+	run_session(session, cin, cout);
 	return 0;
 }
\ No newline at end of file